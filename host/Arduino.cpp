@@ -0,0 +1,74 @@
+/*
+ *  PDDuino - Arduino-based Tandy Portable Disk Drive emulator
+ *  github.com/bkw777/PDDuino
+ *  Based on github.com/TangentDelta/SD2TPDD
+ *
+ *  Copyright (C) 2020  Brian K. White
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>
+ *
+ *  Arduino.cpp: Host clock and virtual GPIO for the Arduino stand-in
+ *
+ */
+
+#include <time.h>
+#include <unistd.h>
+#include "Arduino.h"
+
+static uint8_t pins[HOST_PINS];
+
+static uint64_t now_us(void) {
+  static uint64_t start = 0;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t t = (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+  if(!start) start = t;
+  return t - start;
+}
+
+unsigned long millis(void) {
+  return (unsigned long)(now_us() / 1000);
+}
+
+unsigned long micros(void) {
+  return (unsigned long)now_us();
+}
+
+void delay(unsigned long ms) {
+  usleep(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  usleep(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if(pin < HOST_PINS && mode == INPUT_PULLUP) pins[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if(pin < HOST_PINS) pins[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < HOST_PINS ? pins[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t irq, void (*isr)(void), int mode) {
+  (void)irq; (void)isr; (void)mode;
+}
+
+void detachInterrupt(uint8_t irq) {
+  (void)irq;
+}
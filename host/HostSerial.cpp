@@ -0,0 +1,127 @@
+/*
+ *  PDDuino - Arduino-based Tandy Portable Disk Drive emulator
+ *  github.com/bkw777/PDDuino
+ *  Based on github.com/TangentDelta/SD2TPDD
+ *
+ *  Copyright (C) 2020  Brian K. White
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>
+ *
+ *  HostSerial.cpp: Serial port stand-in over file descriptors
+ *
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include "HostSerial.h"
+
+HostSerial HostClient(0, 1);
+HostSerial HostConsole(-1, 2);
+
+HostSerial::HostSerial(int rfd, int wfd)
+  : m_rfd(rfd), m_wfd(wfd), m_exitOnEof(true), m_baud(0), m_txBusyUntil(0), m_head(0), m_len(0) {}
+
+void HostSerial::attach(int rfd, int wfd, bool exitOnEof) {
+  m_rfd = rfd;
+  m_wfd = wfd;
+  m_exitOnEof = exitOnEof;
+  m_head = m_len = 0;
+}
+
+void HostSerial::begin(unsigned long baud) {
+  (void)baud;
+}
+
+// Pull whatever the other end has sent.  Waits a moment when there is
+// nothing, so the sketch's polling loops don't spin a host cpu at 100%.
+bool HostSerial::fill(void) {
+  if(m_len) return true;
+  if(m_rfd < 0) return false;
+  struct pollfd p = { m_rfd, POLLIN, 0 };
+  if(poll(&p, 1, 1) <= 0) return false;
+  ssize_t n = ::read(m_rfd, m_rx, sizeof(m_rx));
+  if(n > 0) {
+    m_head = 0;
+    m_len = (uint16_t)n;
+    return true;
+  }
+  if(n == 0 || (errno != EAGAIN && errno != EINTR)) {
+    if(m_exitOnEof) {
+      flush();
+      exit(0);
+    }
+    usleep(10000);  // pty with nobody on the other end
+  }
+  return false;
+}
+
+int HostSerial::available(void) {
+  fill();
+  return m_len;
+}
+
+int HostSerial::read(void) {
+  if(!fill()) return -1;
+  m_len--;
+  return m_rx[m_head++];
+}
+
+int HostSerial::peek(void) {
+  if(!fill()) return -1;
+  return m_rx[m_head];
+}
+
+// At a real line rate the core's tx ring fills and write() blocks until
+// there is room.  Do the same, so timings look like the hardware.
+void HostSerial::pace(size_t len) {
+  if(!m_baud) return;
+  unsigned long now = micros();
+  unsigned long perByte = 10000000UL / m_baud;   // 8N1 = 10 bits
+  if((long)(m_txBusyUntil - now) < 0) m_txBusyUntil = now;
+  m_txBusyUntil += len * perByte;
+  unsigned long backlog = HOST_SERIAL_TX_SZ * perByte;
+  if((long)(m_txBusyUntil - now) > (long)backlog)
+    delayMicroseconds(m_txBusyUntil - now - backlog);
+}
+
+size_t HostSerial::write(const uint8_t *buf, size_t len) {
+  size_t done = 0;
+  if(m_wfd < 0) return len;
+  while(done < len) {
+    ssize_t n = ::write(m_wfd, buf + done, len - done);
+    if(n < 0) {
+      if(errno == EINTR || errno == EAGAIN) continue;
+      break;
+    }
+    done += n;
+  }
+  pace(done);
+  return done;
+}
+
+int HostSerial::availableForWrite(void) {
+  if(!m_baud) return HOST_SERIAL_TX_SZ;
+  unsigned long now = micros();
+  if((long)(m_txBusyUntil - now) <= 0) return HOST_SERIAL_TX_SZ;
+  long queued = (m_txBusyUntil - now) / (10000000UL / m_baud);
+  return queued >= HOST_SERIAL_TX_SZ ? 0 : HOST_SERIAL_TX_SZ - queued;
+}
+
+void HostSerial::flush(void) {
+  if(m_baud) {
+    unsigned long now = micros();
+    if((long)(m_txBusyUntil - now) > 0) delayMicroseconds(m_txBusyUntil - now);
+  }
+}
@@ -0,0 +1,72 @@
+/*
+ *  PDDuino - Arduino-based Tandy Portable Disk Drive emulator
+ *  github.com/bkw777/PDDuino
+ *  Based on github.com/TangentDelta/SD2TPDD
+ *
+ *  Copyright (C) 2020  Brian K. White
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>
+ *
+ *  HostSerial.h: Serial port stand-in over file descriptors (stdio, pipe or pty)
+ *
+ */
+
+#ifndef HOST_SERIAL_H
+#define HOST_SERIAL_H
+
+#include "Arduino.h"
+
+#define HOST_SERIAL_RX_SZ   0x100
+#define HOST_SERIAL_TX_SZ   0x40    // same as a typical core's tx ring, for pacing
+
+class HostSerial : public Stream {
+public:
+  HostSerial(int rfd, int wfd);
+  // Change the descriptors.  -1 for none.  exitOnEof ends the process when
+  // the other end goes away, which is what a piped session wants.
+  void attach(int rfd, int wfd, bool exitOnEof);
+  // The sketch's own baud setting is ignored, see lineRate()
+  void begin(unsigned long baud);
+  // baud > 0 paces writes at that line rate, 0 writes as fast as possible
+  void lineRate(unsigned long baud) { m_baud = baud; }
+  void end(void) {}
+  operator bool() { return true; }
+
+  int available(void);
+  int read(void);
+  int peek(void);
+  using Print::write;
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t len);
+  int availableForWrite(void);
+  void flush(void);
+
+private:
+  bool fill(void);
+  void pace(size_t len);
+
+  int m_rfd;
+  int m_wfd;
+  bool m_exitOnEof;
+  unsigned long m_baud;
+  unsigned long m_txBusyUntil;   // micros() when the simulated line goes idle
+  uint8_t m_rx[HOST_SERIAL_RX_SZ];
+  uint16_t m_head;
+  uint16_t m_len;
+};
+
+extern HostSerial HostClient;   // the TPDD client port
+extern HostSerial HostConsole;  // the debug console
+
+#endif /* HOST_SERIAL_H */
@@ -0,0 +1,3 @@
+/*
+ *  SPI.h: Empty host stand-in, nothing the sketch uses lives here
+ */
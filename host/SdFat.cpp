@@ -0,0 +1,418 @@
+/*
+ *  PDDuino - Arduino-based Tandy Portable Disk Drive emulator
+ *  github.com/bkw777/PDDuino
+ *  Based on github.com/TangentDelta/SD2TPDD
+ *
+ *  Copyright (C) 2020  Brian K. White
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>
+ *
+ *  SdFat.cpp: Host directory backed implementation of the SdFat stand-in
+ *
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "SdFat.h"
+
+host_sd_stats_t host_sd_stats;
+uint32_t host_sd_latency_us = 0;
+
+struct HostFd {
+  int fd;
+  explicit HostFd(int f) : fd(f) {}
+  ~HostFd() { if(fd >= 0) ::close(fd); }
+};
+
+static std::string g_root = ".";
+static FatFile g_vwd;
+
+// Each directory is a table of slots, like a FAT directory.  Deleted
+// entries leave a hole that the next create reuses, so an entry keeps its
+// index for as long as it exists.  Loaded from the host the first time the
+// directory is touched, and kept up to date by our own changes after that.
+static std::map<std::string, std::vector<std::string> > g_dirs;
+
+static std::string join(const std::string& dir, const std::string& name) {
+  if(dir.empty()) return name;
+  if(name.empty()) return dir;
+  return dir + "/" + name;
+}
+
+static std::string host_path(const std::string& rel) {
+  return rel.empty() ? g_root : g_root + "/" + rel;
+}
+
+static void charge_dir(uint32_t entries) {
+  uint32_t before = host_sd_stats.dirEntries / (512 / HOST_DIR_ENTRY_SZ);
+  host_sd_stats.dirEntries += entries;
+  uint32_t blocks = host_sd_stats.dirEntries / (512 / HOST_DIR_ENTRY_SZ) - before;
+  if(host_sd_latency_us && blocks) delayMicroseconds(blocks * host_sd_latency_us);
+}
+
+static void charge_data(uint32_t *counter, uint32_t bytes) {
+  uint32_t blocks = (bytes + 511) / 512;
+  *counter += blocks;
+  if(host_sd_latency_us && blocks) delayMicroseconds(blocks * host_sd_latency_us);
+}
+
+static std::vector<std::string>& slots(const std::string& dir) {
+  std::map<std::string, std::vector<std::string> >::iterator it = g_dirs.find(dir);
+  if(it != g_dirs.end()) return it->second;
+  std::vector<std::string>& v = g_dirs[dir];
+  DIR* d = opendir(host_path(dir).c_str());
+  if(d) {
+    struct dirent* e;
+    while((e = readdir(d)) != NULL) {
+      if(strcmp(e->d_name, ".") && strcmp(e->d_name, ".."))
+        v.push_back(e->d_name);
+    }
+    closedir(d);
+    std::sort(v.begin(), v.end());
+  }
+  return v;
+}
+
+static int find_slot(const std::string& dir, const std::string& name) {
+  std::vector<std::string>& v = slots(dir);
+  for(size_t i = 0; i < v.size(); i++)
+    if(!v[i].empty() && !strcasecmp(v[i].c_str(), name.c_str())) return (int)i;
+  return -1;
+}
+
+static uint16_t add_slot(const std::string& dir, const std::string& name) {
+  std::vector<std::string>& v = slots(dir);
+  for(size_t i = 0; i < v.size(); i++)
+    if(v[i].empty()) { v[i] = name; return (uint16_t)i; }
+  v.push_back(name);
+  return (uint16_t)(v.size() - 1);
+}
+
+static bool is_host_dir(const std::string& rel) {
+  struct stat st;
+  return stat(host_path(rel).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Walk path from base.  On success dir is the directory that holds the last
+// component and name is that component, or empty if path names base itself.
+static bool resolve(const FatFile* base, const std::string& basePath, const char* path,
+                    std::string& dir, std::string& name) {
+  (void)base;
+  std::string cur = (path[0] == '/') ? "" : basePath;
+  std::vector<std::string> parts;
+  const char* p = path;
+  while(*p) {
+    while(*p == '/') p++;
+    const char* s = p;
+    while(*p && *p != '/') p++;
+    if(p > s) parts.push_back(std::string(s, p - s));
+  }
+  for(size_t i = 0; i + 1 < parts.size(); i++) {
+    int idx = find_slot(cur, parts[i]);
+    if(idx < 0) return false;
+    cur = join(cur, slots(cur)[idx]);
+    if(!is_host_dir(cur)) return false;
+  }
+  dir = cur;
+  name = parts.empty() ? "" : parts.back();
+  return true;
+}
+
+FatFile::FatFile()
+  : m_open(false), m_isDir(false), m_isRoot(false), m_flags(0), m_pos(0), m_dirIndex(0) {}
+
+std::string FatFile::hostPath(void) const {
+  return host_path(join(m_dir, m_name));
+}
+
+bool FatFile::openSlot(const std::string& dir, uint16_t index, oflag_t oflag) {
+  std::vector<std::string>& v = slots(dir);
+  if(index >= v.size() || v[index].empty()) return false;
+  std::string rel = join(dir, v[index]);
+  bool isDir = is_host_dir(rel);
+  int acc = oflag & O_ACCMODE;
+  if(isDir) {
+    if(acc != O_RDONLY || (oflag & (O_TRUNC | O_AT_END | O_APPEND))) return false;
+  } else {
+    int fd = ::open(host_path(rel).c_str(), acc == O_RDONLY ? O_RDONLY : O_RDWR);
+    if(fd < 0) return false;
+    if((oflag & O_TRUNC) && acc != O_RDONLY && ftruncate(fd, 0) != 0) { ::close(fd); return false; }
+    m_fd.reset(new HostFd(fd));
+  }
+  m_open = true;
+  m_isDir = isDir;
+  m_isRoot = false;
+  m_flags = oflag;
+  m_dir = dir;
+  m_name = v[index];
+  m_dirIndex = index;
+  m_pos = (!isDir && (oflag & (O_AT_END | O_APPEND))) ? fileSize() : 0;
+  return true;
+}
+
+bool FatFile::open(FatFile* dirFile, const char* path, oflag_t oflag) {
+  std::string dir, name;
+
+  if(m_open || !dirFile || !dirFile->isDir()) return false;
+  if(!resolve(dirFile, dirFile->m_isRoot ? "" : join(dirFile->m_dir, dirFile->m_name), path, dir, name))
+    return false;
+  if(name.empty()) {
+    if(!dir.empty()) {  // a subdirectory by itself, find it in its parent
+      size_t slash = dir.rfind('/');
+      std::string parent = slash == std::string::npos ? "" : dir.substr(0, slash);
+      std::string leaf = slash == std::string::npos ? dir : dir.substr(slash + 1);
+      return open(dirFile, ("/" + join(parent, leaf)).c_str(), oflag);
+    }
+    return (oflag & O_ACCMODE) == O_RDONLY && openRoot();
+  }
+  charge_dir(slots(dir).size());
+  int idx = find_slot(dir, name);
+  if(idx < 0) {
+    if(!(oflag & O_CREAT) || (oflag & O_ACCMODE) == O_RDONLY) return false;
+    int fd = ::open(host_path(join(dir, name)).c_str(), O_CREAT | O_RDWR, 0644);
+    if(fd < 0) return false;
+    ::close(fd);
+    idx = add_slot(dir, name);
+  } else if((oflag & O_CREAT) && (oflag & O_EXCL)) {
+    return false;
+  }
+  return openSlot(dir, (uint16_t)idx, oflag);
+}
+
+bool FatFile::open(FatFile* dirFile, uint16_t index, oflag_t oflag) {
+  if(m_open || !dirFile || !dirFile->isDir()) return false;
+  std::string dir = dirFile->m_isRoot ? "" : join(dirFile->m_dir, dirFile->m_name);
+  charge_dir(1);
+  dirFile->m_pos = (uint32_t)(index + 1) * HOST_DIR_ENTRY_SZ;
+  return openSlot(dir, index, oflag);
+}
+
+bool FatFile::openRoot(void) {
+  if(m_open) return false;
+  m_open = m_isDir = m_isRoot = true;
+  m_flags = O_RDONLY;
+  m_dir.clear();
+  m_name.clear();
+  m_pos = 0;
+  m_dirIndex = 0;
+  return true;
+}
+
+bool FatFile::openNext(FatFile* dirFile, oflag_t oflag) {
+  if(m_open || !dirFile || !dirFile->isDir()) return false;
+  std::string dir = dirFile->m_isRoot ? "" : join(dirFile->m_dir, dirFile->m_name);
+  std::vector<std::string>& v = slots(dir);
+  size_t i = dirFile->m_pos / HOST_DIR_ENTRY_SZ;
+  for(; i < v.size(); i++) {
+    charge_dir(1);
+    if(!v[i].empty()) {
+      dirFile->m_pos = (uint32_t)(i + 1) * HOST_DIR_ENTRY_SZ;
+      return openSlot(dir, (uint16_t)i, oflag);
+    }
+  }
+  charge_dir(1);  // the end-of-directory marker
+  dirFile->m_pos = (uint32_t)v.size() * HOST_DIR_ENTRY_SZ;
+  return false;
+}
+
+bool FatFile::close(void) {
+  m_open = m_isDir = m_isRoot = false;
+  m_fd.reset();
+  m_pos = 0;
+  return true;
+}
+
+bool FatFile::getName(char* name, size_t size) {
+  if(!m_open || !size) return false;
+  if(m_isRoot) { name[0] = '/'; if(size > 1) name[1] = 0; return true; }
+  strncpy(name, m_name.c_str(), size - 1);
+  name[size - 1] = 0;
+  return true;
+}
+
+uint32_t FatFile::fileSize(void) const {
+  if(!m_open) return 0;
+  if(m_isDir) {
+    std::string dir = m_isRoot ? "" : join(m_dir, m_name);
+    return (uint32_t)slots(dir).size() * HOST_DIR_ENTRY_SZ;
+  }
+  struct stat st;
+  return fstat(m_fd->fd, &st) == 0 ? (uint32_t)st.st_size : 0;
+}
+
+bool FatFile::seekSet(uint32_t pos) {
+  if(!m_open) return false;
+  if(!m_isDir && pos > fileSize()) return false;
+  m_pos = pos;
+  return true;
+}
+
+int FatFile::read(void* buf, size_t nbyte) {
+  if(!isFile() || (m_flags & O_ACCMODE) == O_WRONLY) return -1;
+  ssize_t n = pread(m_fd->fd, buf, nbyte, m_pos);
+  if(n < 0) return -1;
+  m_pos += n;
+  charge_data(&host_sd_stats.blocksRead, n);
+  return (int)n;
+}
+
+int FatFile::write(const void* buf, size_t nbyte) {
+  if(!isFile() || (m_flags & O_ACCMODE) == O_RDONLY) return -1;
+  if(m_flags & (O_AT_END | O_APPEND)) m_pos = fileSize();
+  ssize_t n = pwrite(m_fd->fd, buf, nbyte, m_pos);
+  if(n < 0) return -1;
+  m_pos += n;
+  charge_data(&host_sd_stats.blocksWritten, n);
+  return (int)n;
+}
+
+bool FatFile::truncate(uint32_t length) {
+  if(!isFile() || (m_flags & O_ACCMODE) == O_RDONLY) return false;
+  if(ftruncate(m_fd->fd, length) != 0) return false;
+  if(m_pos > length) m_pos = length;
+  return true;
+}
+
+bool FatFile::mkdir(FatFile* dir, const char* path, bool pFlag) {
+  std::string parent, name;
+  (void)pFlag;
+  if(m_open || !dir || !dir->isDir()) return false;
+  if(!resolve(dir, dir->m_isRoot ? "" : join(dir->m_dir, dir->m_name), path, parent, name)) return false;
+  if(name.empty() || find_slot(parent, name) >= 0) return false;
+  if(::mkdir(host_path(join(parent, name)).c_str(), 0755) != 0) return false;
+  slots(join(parent, name));  // new and empty
+  return openSlot(parent, add_slot(parent, name), O_RDONLY);
+}
+
+bool FatFile::remove(void) {
+  if(!isFile() || (m_flags & O_ACCMODE) == O_RDONLY) return false;
+  if(unlink(hostPath().c_str()) != 0) return false;
+  slots(m_dir)[m_dirIndex].clear();
+  return close();
+}
+
+bool FatFile::remove(FatFile* dirFile, const char* path) {
+  FatFile f;
+  return f.open(dirFile, path, O_WRONLY) && f.remove();
+}
+
+bool FatFile::rmdir(void) {
+  if(!isDir() || m_isRoot) return false;
+  std::string self = join(m_dir, m_name);
+  std::vector<std::string>& v = slots(self);
+  for(size_t i = 0; i < v.size(); i++) if(!v[i].empty()) return false;
+  if(::rmdir(hostPath().c_str()) != 0) return false;
+  g_dirs.erase(self);
+  slots(m_dir)[m_dirIndex].clear();
+  return close();
+}
+
+bool FatFile::rename(FatFile* dirFile, const char* newPath) {
+  std::string dir, name;
+  if(!m_open || m_isRoot || !dirFile || !dirFile->isDir()) return false;
+  if(!resolve(dirFile, dirFile->m_isRoot ? "" : join(dirFile->m_dir, dirFile->m_name), newPath, dir, name))
+    return false;
+  if(name.empty() || find_slot(dir, name) >= 0) return false;
+  std::string oldRel = join(m_dir, m_name);
+  std::string newRel = join(dir, name);
+  if(::rename(host_path(oldRel).c_str(), host_path(newRel).c_str()) != 0) return false;
+  slots(m_dir)[m_dirIndex].clear();
+  if(m_isDir) {  // carry the slot tables of the moved tree along
+    std::map<std::string, std::vector<std::string> > moved;
+    for(std::map<std::string, std::vector<std::string> >::iterator it = g_dirs.begin(); it != g_dirs.end(); ) {
+      if(it->first == oldRel || it->first.compare(0, oldRel.size() + 1, oldRel + "/") == 0) {
+        moved[newRel + it->first.substr(oldRel.size())] = it->second;
+        g_dirs.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+    g_dirs.insert(moved.begin(), moved.end());
+  }
+  m_dirIndex = add_slot(dir, name);
+  m_dir = dir;
+  m_name = name;
+  return true;
+}
+
+bool FatFile::createContiguous(FatFile* dirFile, const char* path, uint32_t size) {
+  if(!open(dirFile, path, O_RDWR | O_CREAT | O_EXCL)) return false;
+  if(ftruncate(m_fd->fd, size) != 0) { close(); return false; }
+  return true;
+}
+
+File::File(const char* path, oflag_t oflag) {
+  open(&g_vwd, path, oflag);
+}
+
+int File::available(void) {
+  if(!isFile()) return 0;
+  uint32_t s = fileSize();
+  return m_pos < s ? (int)(s - m_pos) : 0;
+}
+
+int File::peek(void) {
+  uint8_t b;
+  uint32_t pos = m_pos;
+  int r = FatFile::read(&b, 1);
+  m_pos = pos;
+  return r == 1 ? b : -1;
+}
+
+int File::read(void) {
+  uint8_t b;
+  return FatFile::read(&b, 1) == 1 ? b : -1;
+}
+
+void host_sd_root(const char* path) {
+  g_root = path;
+  g_dirs.clear();
+  g_vwd.close();
+}
+
+bool SdFat::begin(...) {
+  g_vwd.close();
+  return is_host_dir("") && g_vwd.openRoot();
+}
+
+FatFile* SdFat::vwd(void) {
+  return &g_vwd;
+}
+
+File SdFat::open(const char* path, oflag_t mode) {
+  File f;
+  f.open(vwd(), path, mode);
+  return f;
+}
+
+bool SdFat::mkdir(const char* path, bool pFlag) {
+  FatFile f;
+  return f.mkdir(vwd(), path, pFlag);
+}
+
+bool SdFat::rename(const char* oldPath, const char* newPath) {
+  FatFile f;
+  return f.open(vwd(), oldPath, O_RDONLY) && f.rename(vwd(), newPath);
+}
+
+bool SdFat::rmdir(const char* path) {
+  FatFile f;
+  return f.open(vwd(), path, O_RDONLY) && f.rmdir();
+}
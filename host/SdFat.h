@@ -0,0 +1,150 @@
+/*
+ *  PDDuino - Arduino-based Tandy Portable Disk Drive emulator
+ *  github.com/bkw777/PDDuino
+ *  Based on github.com/TangentDelta/SD2TPDD
+ *
+ *  Copyright (C) 2020  Brian K. White
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>
+ *
+ *  SdFat.h: SdFat 1.x look-alike backed by a directory on the host
+ *
+ */
+
+#ifndef HOST_SDFAT_H
+#define HOST_SDFAT_H
+
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+typedef int oflag_t;
+
+#define O_READ        O_RDONLY
+#define O_WRITE       O_WRONLY
+#define O_AT_END      0x40000000
+#define FILE_READ     O_RDONLY
+#define FILE_WRITE    (O_RDWR | O_CREAT | O_AT_END)
+
+#define SD_SCK_MHZ(m) (m)
+
+// Directory slots are 32 bytes, same as a FAT directory entry,
+// so curPosition()/seekSet()/dirIndex() mean the same thing they do on a card.
+#define HOST_DIR_ENTRY_SZ   0x20
+
+struct HostFd;
+
+class FatFile {
+public:
+  FatFile();
+  bool open(FatFile* dirFile, const char* path, oflag_t oflag);
+  bool open(FatFile* dirFile, uint16_t index, oflag_t oflag);
+  bool openNext(FatFile* dirFile, oflag_t oflag = O_RDONLY);
+  bool openRoot(void);
+  bool close(void);
+
+  bool isOpen(void) const { return m_open; }
+  bool isDir(void) const { return m_open && m_isDir; }
+  bool isFile(void) const { return m_open && !m_isDir; }
+  bool isHidden(void) const { return m_open && m_name[0] == '.'; }
+  bool getName(char* name, size_t size);
+  uint32_t fileSize(void) const;
+  uint32_t curPosition(void) const { return m_pos; }
+  uint16_t dirIndex(void) const { return m_dirIndex; }
+
+  bool seekSet(uint32_t pos);
+  bool seekCur(int32_t offset) { return seekSet(m_pos + offset); }
+  bool seekEnd(int32_t offset = 0) { return seekSet(fileSize() + offset); }
+  void rewind(void) { m_pos = 0; }
+  int read(void* buf, size_t nbyte);
+  int write(const void* buf, size_t nbyte);
+  bool sync(void) { return m_open; }
+  bool truncate(uint32_t length);
+
+  bool exists(const char* path) { FatFile f; return f.open(this, path, O_RDONLY); }
+  bool mkdir(FatFile* dir, const char* path, bool pFlag = true);
+  bool remove(void);
+  static bool remove(FatFile* dirFile, const char* path);
+  bool rmdir(void);
+  bool rename(FatFile* dirFile, const char* newPath);
+  bool createContiguous(FatFile* dirFile, const char* path, uint32_t size);
+
+protected:
+  bool openSlot(const std::string& dir, uint16_t index, oflag_t oflag);
+  std::string hostPath(void) const;
+
+  bool m_open;
+  bool m_isDir;
+  bool m_isRoot;
+  oflag_t m_flags;
+  uint32_t m_pos;
+  uint16_t m_dirIndex;
+  std::string m_dir;    // containing directory, relative to the card root
+  std::string m_name;
+  std::shared_ptr<HostFd> m_fd;
+};
+
+class File : public FatFile, public Stream {
+public:
+  File() {}
+  File(const char* path, oflag_t oflag);
+  operator bool() { return isOpen(); }
+  int available(void);
+  void flush(void) { sync(); }
+  int peek(void);
+  uint32_t position(void) { return curPosition(); }
+  int read(void);
+  int read(void* buf, size_t nbyte) { return FatFile::read(buf, nbyte); }
+  bool seek(uint32_t pos) { return seekSet(pos); }
+  uint32_t size(void) { return fileSize(); }
+  size_t write(uint8_t b) { return FatFile::write(&b, 1); }
+  size_t write(const uint8_t* buf, size_t size) { return FatFile::write(buf, size); }
+  bool isDirectory(void) { return isDir(); }
+  File openNextFile(oflag_t mode = O_RDONLY) { File tmp; tmp.openNext(this, mode); return tmp; }
+  void rewindDirectory(void) { if(isDir()) rewind(); }
+};
+
+class SdFat {
+public:
+  bool begin(...);
+  void chvol(void) {}
+  FatFile* vwd(void);
+  File open(const char* path, oflag_t mode = FILE_READ);
+  bool exists(const char* path) { return vwd()->exists(path); }
+  bool mkdir(const char* path, bool pFlag = true);
+  bool remove(const char* path) { return FatFile::remove(vwd(), path); }
+  bool rename(const char* oldPath, const char* newPath);
+  bool rmdir(const char* path);
+};
+
+class SdFatSdioEX : public SdFat {};
+
+// Host-side controls
+// Point the "card" at a directory.  Must be called before fs.begin().
+void host_sd_root(const char* path);
+
+// What the emulator has asked of the card so far.
+typedef struct host_sd_stats_s {
+  uint32_t dirEntries;    // directory entries examined
+  uint32_t blocksRead;    // 512-byte data blocks read
+  uint32_t blocksWritten; // 512-byte data blocks written
+} host_sd_stats_t;
+
+extern host_sd_stats_t host_sd_stats;
+
+// Simulated card latency, charged per block, 0 (the default) for none.
+extern uint32_t host_sd_latency_us;
+
+#endif /* HOST_SDFAT_H */
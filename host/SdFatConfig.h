@@ -0,0 +1,3 @@
+/*
+ *  SdFatConfig.h: Empty host stand-in, nothing the sketch uses lives here
+ */
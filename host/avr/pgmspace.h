@@ -0,0 +1,20 @@
+/*
+ *  PDDuino - Arduino-based Tandy Portable Disk Drive emulator
+ *  github.com/bkw777/PDDuino
+ *
+ *  avr/pgmspace.h: Host stand-in, flash and ram are the same thing here
+ *
+ */
+
+#ifndef HOST_PGMSPACE_H
+#define HOST_PGMSPACE_H
+
+#define PROGMEM
+#define PSTR(s)                 (s)
+#define pgm_read_byte(a)        (*(const uint8_t *)(a))
+#define vsnprintf_P             vsnprintf
+#define snprintf_P              snprintf
+#define strlen_P                strlen
+#define strcmp_P                strcmp
+
+#endif /* HOST_PGMSPACE_H */
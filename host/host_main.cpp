@@ -0,0 +1,107 @@
+/*
+ *  PDDuino - Arduino-based Tandy Portable Disk Drive emulator
+ *  github.com/bkw777/PDDuino
+ *  Based on github.com/TangentDelta/SD2TPDD
+ *
+ *  Copyright (C) 2020  Brian K. White
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>
+ *
+ *  host_main.cpp: Run the sketch as a Linux process
+ *
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#include "Arduino.h"
+#include "HostSerial.h"
+#include "SdFat.h"
+#include "../src/config.h"
+
+void setup(void);
+void loop(void);
+
+static void usage(const char *me) {
+  fprintf(stderr,
+    "usage: %s [-d dir] [-p] [-b baud] [-L us] [-l]\n"
+    "  -d dir   directory to serve as the sd card (default .)\n"
+    "  -p       talk over a new pseudo-terminal instead of stdin/stdout\n"
+    "  -b baud  pace output at this line rate (default unpaced)\n"
+    "  -L us    simulated card latency per 512 byte block\n"
+    "  -l       client DTR asserted at power-on, so send " LOADER_FILE "\n",
+    me);
+  exit(2);
+}
+
+static int open_pty(void) {
+  int m = posix_openpt(O_RDWR | O_NOCTTY);
+  if(m < 0 || grantpt(m) || unlockpt(m)) {
+    perror("pty");
+    exit(1);
+  }
+  const char *name = ptsname(m);
+  // Hold the slave open ourselves, raw, so the master doesn't see EOF
+  // every time a client closes it.
+  int s = open(name, O_RDWR | O_NOCTTY);
+  struct termios t;
+  if(s >= 0 && tcgetattr(s, &t) == 0) {
+    cfmakeraw(&t);
+    tcsetattr(s, TCSANOW, &t);
+  }
+  fprintf(stderr, "TPDD port: %s\n", name);
+  return m;
+}
+
+int main(int argc, char **argv) {
+  const char *dir = ".";
+  bool pty = false;
+  bool loader = false;
+  unsigned long baud = 0;
+  int c;
+  struct stat st;
+
+  while((c = getopt(argc, argv, "d:pb:L:l")) != -1) {
+    switch(c) {
+    case 'd': dir = optarg; break;
+    case 'p': pty = true; break;
+    case 'b': baud = strtoul(optarg, NULL, 0); break;
+    case 'L': host_sd_latency_us = strtoul(optarg, NULL, 0); break;
+    case 'l': loader = true; break;
+    default: usage(argv[0]);
+    }
+  }
+  if(stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+    fprintf(stderr, "%s: not a directory\n", dir);
+    return 1;
+  }
+  host_sd_root(dir);
+
+  if(pty) {
+    int m = open_pty();
+    HostClient.attach(m, m, false);
+  } else {
+    HostClient.attach(0, 1, true);
+  }
+  HostClient.lineRate(baud);
+
+  // DSR is active low
+  digitalWrite(DSR_PIN, loader ? LOW : HIGH);
+
+  setup();
+  for(;;) loop();
+}
@@ -0,0 +1,3 @@
+/*
+ *  sdios.h: Empty host stand-in, nothing the sketch uses lives here
+ */
@@ -36,19 +36,19 @@ SdFatSdioEX fs;
 SdFat fs;
 #endif
 
-  static byte checksum = 0x00;  //Global variable for checksum calculation
-
   static bool DME = false; //TS-DOS DME mode flag
 
   static uint8_t _buffer[DATA_BUFFER_SZ]; //Data buffer for commands
   static uint8_t _length;
 
-  static byte fileBuffer[FILE_BUFFER_SZ]; //Data buffer for file reading
+  static uint8_t _frame[FRAME_BUFFER_SZ]; //Response frame under construction
+  static uint8_t _frameLen;
 
   static char refFileName[FILENAME_SZ] = "";  //Reference file name for emulator
   static char refFileNameNoDir[FILENAME_SZ] = ""; //Reference file name for emulator with no ".<>" if directory
   static char tempRefFileName[FILENAME_SZ] = ""; //Second reference file name for renaming
-  static byte directoryBlock = 0x00; //Current directory block for directory listing
+  static uint32_t enumPos = 0x00; //Byte position in root of the next directory entry to enumerate
+  static uint16_t enumIndex = 0x00; //Directory index of the entry last returned by the enumeration
   static char directory[DIRECTORY_SZ] = "/";
   static byte directoryDepth = 0x00;
   static char tempDirectory[DIRECTORY_SZ] = "/";
@@ -60,7 +60,7 @@ SdFat fs;
 
   static File entry; //Moving file entry for the emulator
   static File tempEntry; //Temporary entry for moving files
-  static File root;  //Root file for filesystem reference
+  static File root;  //Directory handle held open across an ENUM_FIRST/ENUM_NEXT session
 
 // Append a string to directory[]
 static void append_dir(const char* c){
@@ -140,29 +140,54 @@ static void set_label(const char* s) {
  *
  */
 
-static void send_byte(char c){  //Outputs char c to TPDD port and adds to the checksum
-  checksum += c;
-  CLIENT.write(c);
-  LOGV_P("O:%2.2X(%c)>%2.2X", (uint8_t)c, (c > 0x20 && (uint8_t)c < 0x80 ? c : ' '), checksum);
+/*
+ * Responses are assembled in _frame[] and go out in one write, so the
+ * checksum is one pass and the uart driver is called once per packet.
+ * frame_begin() ... frame_byte()/frame_bytes() ... frame_send()
+ */
+static void frame_begin(uint8_t type) {  //Start a frame with return type and room for the length
+  _frame[0] = type;
+  _frameLen = 2;
 }
 
-static void send_buffer(uint8_t *data, uint16_t len) {
-  for(uint16_t i = 0; i < len; i++) {
-    send_byte(data[i]);
-  }
+static void frame_begin_raw(void) {  //Start a frame without the type/length header
+  _frameLen = 0;
+}
+
+static void frame_byte(uint8_t c) {
+  if(_frameLen < FRAME_BUFFER_SZ - 1) _frame[_frameLen++] = c;
+}
+
+static void frame_bytes(const uint8_t *data, uint8_t len) {
+  if(len > FRAME_BUFFER_SZ - 1 - _frameLen) len = FRAME_BUFFER_SZ - 1 - _frameLen;
+  memcpy(_frame + _frameLen, data, len);
+  _frameLen += len;
+}
+
+static void frame_pad(uint8_t c, uint8_t len) {
+  while(len--) frame_byte(c);
+}
+
+static void frame_send_hdr(bool hdr) {
+  uint8_t chk = 0;
+
+  if(hdr) _frame[1] = _frameLen - 2;  //Data size
+  for(uint8_t i = 0; i < _frameLen; i++) chk += _frame[i];
+  _frame[_frameLen++] = chk ^ 0xff;  //Checksum
+  CLIENT.write(_frame, _frameLen);
+  LOGV_P("O:%2.2X|L:%2.2X|C:%2.2X", _frame[0], _frameLen, _frame[_frameLen - 1]);
 }
 
-static void send_chksum(void) {  //Outputs the checksum to the TPDD port and clears the checksum
-  uint8_t chk = checksum ^ 0xff;
-  CLIENT.write(chk);
-  LOGV_P("O:%2.2X", chk);
-  checksum = 0;
+static void frame_send(void) {
+  frame_send_hdr(true);
 }
 
-static void send_dir_suffix(void) {
-  send_byte('.');   //Tack the expected ".<>" to the end of the name
-  send_byte('<');
-  send_byte('>');
+static void frame_send_raw(void) {
+  frame_send_hdr(false);
+}
+
+static void frame_dir_suffix(void) {
+  frame_bytes((const uint8_t *)".<>", 3);   //Tack the expected ".<>" to the end of the name
 }
 
 
@@ -176,10 +201,9 @@ static void send_ret_normal(error_t errorCode){ //Sends a normal return to the T
 
   LOGD_P("%s() entry",__func__);
   LOGD_P("R:Norm %2.2X", errorCode);
-  send_byte(RET_NORMAL);  //Return type (normal)
-  send_byte(0x01);  //Data size (1)
-  send_byte(errorCode); //Error code
-  send_chksum(); //Checksum
+  frame_begin(RET_NORMAL);  //Return type (normal)
+  frame_byte(errorCode); //Error code
+  frame_send();
   LOGD_P("%s() exit",__func__);
 }
 
@@ -188,58 +212,46 @@ static void send_ref(const char *name, bool isDir, uint32_t size ) {
 
   LOGD_P("%s() entry",__func__);
   LOGI_P("N:'%s':D%d-%d", name, isDir, size);
-  send_byte(RET_DIRECTORY);    //Return type (reference)
+  frame_begin(RET_DIRECTORY);    //Return type (reference)
   // filename + attribute + length + free sector count
-#ifdef ENABLE_TPDD_EXTENSIONS
-  if(size > 65535)
-    send_byte(FILENAME_SZ + 1 + 4 + 1);    //Data size (1E)
-  else
-#endif
-    send_byte(FILENAME_SZ + 1 + 2 + 1);    //Data size (1C)
   if(name == NULL) {
-    for(i = 0; i < FILENAME_SZ; i++)
-      send_byte(0x00);  //Write the reference file name to the TPDD port
+    frame_pad(0x00, FILENAME_SZ);
   } else {
     if(isDir && DME) {  // handle dirname.
       for(i = 0; (i < 6) && (name[i] != 0); i++)
-        send_byte(name[i]);
-      for(;i < 6; i++)
-        send_byte(' '); // pad out the dir
-      send_dir_suffix();
+        frame_byte(name[i]);
+      frame_pad(' ', 6 - i); // pad out the dir
+      frame_dir_suffix();
       j = 9;
     } else {
       for(i = 0; (i < 6) && (name[i] != '.'); i++) {
-        send_byte(name[i]);
+        frame_byte(name[i]);
       }
-      for(j = i; j < 6; j++) {
-        send_byte(' ');
+      frame_pad(' ', 6 - i);
+      for(j = 6; j < FILENAME_SZ && (name[i] != 0); j++) {
+        frame_byte(name[i++]);  // send the file extension
       }
-      for(; j < FILENAME_SZ && (name[i] != 0); j++) {
-        send_byte(name[i++]);  // send the file extension
-      }
-    }
-    for(; j < FILENAME_SZ; j++) {
-      send_byte('\0');  // pad out
     }
+    frame_pad('\0', FILENAME_SZ - j);  // pad out
   }
   // other implementation send 'F' here:
   //tpddWrite(0);  //Attribute, unused
-  send_byte((name == NULL ? '\0' : 'F'));
-  send_byte((uint8_t)(size >> 8));  //File size most significant byte
-  send_byte((uint8_t)(size)); //File size least significant byte
+  frame_byte((name == NULL ? '\0' : 'F'));
+  frame_byte((uint8_t)(size >> 8));  //File size most significant byte
+  frame_byte((uint8_t)(size)); //File size least significant byte
 #ifdef ENABLE_TPDD_EXTENSIONS
   if(size > 65535) {
-    send_byte('P');  //Free sectors, SD card has more than we'll ever care about
+    frame_byte('P');  //Free sectors, SD card has more than we'll ever care about
     //tpddWrite(0x80);  //Free sectors, SD card has more than we'll ever care about
-    send_byte((uint8_t)(size >> 24));  //File size most significant byte
-    send_byte((uint8_t)(size >> 16)); //File size next most significant byte
+    frame_byte((uint8_t)(size >> 24));  //File size most significant byte
+    frame_byte((uint8_t)(size >> 16)); //File size next most significant byte
   } else
 #endif
-    //send_byte(0x80);  //Free sectors, SD card has more than we'll ever care about
+    //frame_byte(0x80);  //Free sectors, SD card has more than we'll ever care about
     // Note: ts-dos only uses the value returned on the last dir entry.
     // and that entry is often empty...
-    send_byte(0x9d);  //Free sectors, SD card has more than we'll ever care about
-  send_chksum(); //Checksum
+    frame_byte(0x9d);  //Free sectors, SD card has more than we'll ever care about
+  frame_send();
 
   LOGD_P("%s() exit",__func__);
 }
@@ -277,28 +289,46 @@ static void send_parent_ref(void) {
  *
  */
 
+// Drop the enumeration handle.  Call after anything that changes the
+// directory (write, rename, delete, mkdir) or moves to another one.
+// The next ENUM_NEXT reopens it and picks up at enumPos.
+static void enum_invalidate(void) {
+  if(root) root.close();
+}
+
+// (Re)open the enumeration handle on directory[] at the saved position.
+static bool enum_open(void) {
+  if(!root) {
+    root = fs.open(directory);
+    if(!root) return false;
+    root.seekSet(enumPos);
+  }
+  return true;
+}
+
+// Entries the client should never see
+static bool enum_skip(File &f) {
+  return f.isHidden() || (f.isDirectory() && !DME);
+}
+
 static void ret_next_ref(void) {
 
   LOGD_P("%s() entry",__func__);
   if(_sysstate == SYS_ENUM) {   // We are enumerating the directory
-    directoryBlock++; //Increment the directory entry index
     led_sd_on();
-    root.rewindDirectory(); //Pull back to the begining of the directory
-    for(uint8_t i = 0x00; i < directoryBlock - 0x01; i++)
-      root.openNextFile();  //skip to the current entry offset by the index
-
-    //Open the entry
-    if(entry = root.openNextFile()) {  //If the entry exists it is returned
-      if(entry.isHidden() || (entry.isDirectory() && !DME)) {
-        //If it's a directory and we're not in DME mode or file/dir is hidden
-        entry.close();  //the entry is skipped over
-        ret_next_ref(); //and this function is called again
-      } else {
-        send_normal_ref(); //Send the reference info to the TPDD port
-        entry.close();  //Close the entry
-      }
+    if(enum_open()) {
+      while((entry = root.openNextFile()) && enum_skip(entry))
+        entry.close();  //Hidden entries, and directories if we're not in DME mode, are skipped over
+      enumPos = root.curPosition(); //Remember where the next entry starts
+    }
+
+    if(entry) {  //If the entry exists it is returned
+      enumIndex = entry.dirIndex();
+      send_normal_ref(); //Send the reference info to the TPDD port
+      entry.close();  //Close the entry
       led_sd_off();
     } else {
+      enumIndex = enumPos / 0x20; //Park just past the last entry, so ENUM_PREV finds it
       led_sd_off();
       send_blank_ref();
     }
@@ -309,10 +339,49 @@ static void ret_next_ref(void) {
   LOGD_P("%s() exit",__func__);
 }
 
+static void ret_prev_ref(void) {
+
+  LOGD_P("%s() entry",__func__);
+  if(_sysstate == SYS_ENUM) {
+    led_sd_on();
+    if(enum_open()) {
+      // Walk back one directory slot at a time until we land on a visible entry.
+      while(enumIndex > 0x00) {
+        if(entry.open(&root, --enumIndex, O_READ)) {
+          if((entry.isFile() || entry.isDirectory()) && !enum_skip(entry))
+            break;
+          entry.close();
+        }
+      }
+      enumPos = (uint32_t)(enumIndex + (entry ? 1 : 0)) * 0x20;
+      root.seekSet(enumPos);
+    }
+
+    if(entry) {
+      send_normal_ref();
+      entry.close();
+      led_sd_off();
+    } else {  // backed up past the first entry
+      enumPos = 0x00;
+      enumIndex = 0x00;
+      led_sd_off();
+      if(DME && directoryDepth > 0x00)
+        send_parent_ref();
+      else
+        send_blank_ref();
+    }
+  } else {
+    _sysstate = SYS_IDLE;
+    send_ret_normal(ERR_DIR_SEARCH);
+  }
+  LOGD_P("%s() exit",__func__);
+}
+
 static void ret_first_ref(void) {
 
   LOGD_P("%s() entry",__func__);
-  directoryBlock = 0x00; //Set the current directory entry index to 0
+  enumPos = 0x00; //Start over at the beginning of the directory
+  enumIndex = 0x00;
   if(DME && directoryDepth > 0x00) { //Return the "PARENT.<>" reference if we're in DME mode
     led_sd_off();
     send_parent_ref();
@@ -372,21 +441,14 @@ static void req_reference(void) { // File/Dir Reference command handler
     break;
   case ENUM_FIRST:  //Request first directory block
     _sysstate = SYS_ENUM;
-    led_sd_on();
-    root.close();
-    root = fs.open(directory);
+    enum_invalidate();  //Always start a listing from a fresh handle
     ret_first_ref();
     break;
   case ENUM_NEXT:   //Request next directory block
-    led_sd_on();
-    root.close();
-    root = fs.open(directory);
     ret_next_ref();
     break;
-  case ENUM_PREV:
-    // TODO really should back up the dir one...
-    _sysstate = SYS_IDLE;
-    send_ret_normal(ERR_PARM);  //  For now, send some error back
+  case ENUM_PREV:   //Request previous directory block
+    ret_prev_ref();
     break;
   default:          //Parameter is invalid
     _sysstate = SYS_IDLE;
@@ -410,6 +472,7 @@ static void req_open(void) {  //Opens an entry for reading, writing, or appendin
 
   if(_sysstate == SYS_REF) {
     entry.close();
+    enum_invalidate();  //We may create a file or directory, or change directory
 
     if(DME && strcmp(refFileNameNoDir, "PARENT") == 0) { //If DME mode is enabled and the reference is for the "PARENT" directory
       remove_subdir();  //The top-most entry in the directory buffer is taken away
@@ -498,14 +561,13 @@ static void req_read(){  //Read a block of data from the currently open entry
   LOGD_P("%s() entry",__func__);
   if((_sysstate == SYS_READ) || (_sysstate == SYS_READ_WRITE)) {
     led_sd_on();
-    byte bytesRead = entry.read(fileBuffer, FILE_BUFFER_SZ); //Try to pull 128 bytes from the file into the buffer
+    frame_begin(RET_READ);  //Return type
+    int bytesRead = entry.read(_frame + _frameLen, FILE_BUFFER_SZ); //Try to pull 128 bytes from the file straight into the frame
     led_sd_off();
     LOGV_P("A: %4X", entry.available());
     if(bytesRead > 0x00){  //Send the read return if there is data to be read
-      send_byte(RET_READ);  //Return type
-      send_byte(bytesRead); //Data length
-      send_buffer(fileBuffer, bytesRead);
-      send_chksum();
+      _frameLen += bytesRead;
+      frame_send();
     } else { //send a normal return with an end-of-file error if there is no data left to read
       send_ret_normal(ERR_EOF);
     }
@@ -558,6 +620,7 @@ static void req_delete(){  //Delete the currently open entry
   if(_sysstate == SYS_REF) {
     led_sd_on();
     entry.close();  //Close any open entries
+    enum_invalidate();
     append_dir(refFileNameNoDir);  //Push the reference name onto the directory buffer
     entry = fs.open(directory, FILE_READ);  //directory can be deleted if opened "READ"
 
@@ -604,10 +667,9 @@ static void req_status(){  //Drive status
 static void req_condition(){
 
   LOGD_P("%s() entry",__func__);
-  send_byte(RET_CONDITION);  //Return type (normal)
-  send_byte(0x01);  //Data size (1)
-  send_byte(ERR_SUCCESS); //Error code
-  send_chksum(); //Checksum
+  frame_begin(RET_CONDITION);  //Return type (normal)
+  frame_byte(ERR_SUCCESS); //Error code
+  frame_send();
   LOGD_P("%s() exit",__func__);
 }
 
@@ -625,6 +687,7 @@ static void req_rename(){  //Renames the currently open entry
     led_sd_on();
 
     if(entry) entry.close(); //Close any currently open entries
+    enum_invalidate();
     entry = fs.open(directory); //Open the entry
     if(entry.isDirectory()) append_dir("/"); //Append a slash to the end of the directory buffer if the reference is a sub-directory
 
@@ -720,11 +783,12 @@ static void req_tell(void) {
   // Only tell if you have a file open
   if((_sysstate == SYS_WRITE) || (_sysstate == SYS_READ) || (_sysstate == SYS_READ_WRITE)) {
     pos = entry.curPosition();
-    send_byte((uint8_t)pos);
-    send_byte((uint8_t)(pos >> 8));
-    send_byte((uint8_t)(pos >> 16));
-    send_byte((uint8_t)(pos >> 24));
-    send_chksum();
+    frame_begin_raw();
+    frame_byte((uint8_t)pos);
+    frame_byte((uint8_t)(pos >> 8));
+    frame_byte((uint8_t)(pos >> 16));
+    frame_byte((uint8_t)(pos >> 24));
+    frame_send_raw();
   } else {
     send_ret_normal(ERR_NO_NAME);     // no file opened for reading or writing.
   }
@@ -753,13 +817,12 @@ static void req_dme_label() {  //Send the dmeLabel
   DME = true;
   // prepend "/" to the root dir label just because my janky-ass set_label() assumes it
   if (directoryDepth > 0) set_label(directory); else set_label("/SD:   ");
-  send_byte(RET_NORMAL);
-  send_byte(0x0B);
-  send_byte(0x20);
-  for (byte i=0x00 ; i<0x06 ; i++) send_byte(dmeLabel[i]);
-  send_dir_suffix();
-  send_byte(' ');
-  send_chksum();
+  frame_begin(RET_NORMAL);
+  frame_byte(0x20);
+  frame_bytes((const uint8_t *)dmeLabel, 0x06);
+  frame_dir_suffix();
+  frame_byte(' ');
+  frame_send();
   LOGD_P("%s() exit",__func__);
 }
 
@@ -772,10 +835,9 @@ static void req_dme_label() {  //Send the dmeLabel
 static void req_unknown_1(void) {
 
   LOGD_P("%s() entry",__func__);
-  send_byte(RET_TSDOS_UNK_1);
-  send_byte(0x01);  //Data size (1)
-  send_byte(ERR_SUCCESS);
-  send_chksum();
+  frame_begin(RET_TSDOS_UNK_1);
+  frame_byte(ERR_SUCCESS);
+  frame_send();
   LOGD_P("%s() exit",__func__);
 }
 
@@ -786,10 +848,9 @@ static void req_unknown_2(void) {
 
 
   LOGD_P("%s() entry",__func__);
-  send_byte(RET_UNKNOWN_2);
-  send_byte(sizeof(data));
-  send_buffer((uint8_t *)data, sizeof(data));
-  send_chksum();
+  frame_begin(RET_UNKNOWN_2);
+  frame_bytes(data, sizeof(data));
+  frame_send();
   LOGD_P("%s() exit",__func__);
 }
 #endif
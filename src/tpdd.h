@@ -29,6 +29,7 @@
 #define FILENAME_SZ 0x18        // TPDD protocol spec 1C, minus 4 for ".<>"+NULL
 #define DATA_BUFFER_SZ 0x0100   // 256 bytes, 2 full tpdd packets? 0xFF did not work.
 #define FILE_BUFFER_SZ 0x80     // 128 bytes at at time to/from files
+#define FRAME_BUFFER_SZ (FILE_BUFFER_SZ + 3)  // type + length + payload + checksum
 
 #define ENABLE_TPDD_EXTENSIONS  // If you want to enable the extensions
 